@@ -18,8 +18,6 @@
  * Program 5: Mancala
  * 11/27/2012
  *
- *   ToDo: delete Nodes once they are no longer needed in recursion
- *
  * Running the program looks like:
  
  Author: Dale Reed
@@ -125,6 +123,16 @@
  */
 
 #include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <vector>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <signal.h>
 using namespace std;
 
 // Global constants
@@ -132,6 +140,7 @@ const int BoardSize = 14;           // array size to hold playing pieces for bot
 const int MaxRecursionDepth = 3;    // maximum depth for recursive move checking
 const bool DisplayMessages = true;  // flag used to display messages when making actual moves
 const bool NoMessages = false;      // flag used to turn off messages when exploring possible moves
+const char NoMove = '-';            // analysis result when no move scores above the worst possible score
 
 struct Node {
     int theBoard[ BoardSize];// copy of the board
@@ -147,28 +156,225 @@ struct PlayerMove{
        PlayerMove * nextMove; //Pointer to the next PlayerMove
 };
 
+// Structure-of-arrays batch of sibling positions, used to score all the children of a
+// frontier node at once.  Each pit has its own row of lanes, one lane per position, so the
+// scoring loops run down contiguous memory and can be vectorized by the compiler.
+// Lanes past the number of children in use are kept zeroed.
+const int LeafBatchSize = 8;        // lanes per batch, enough to hold the six sibling moves
+struct LeafBatch {
+    int pits[ BoardSize][ LeafBatchSize];  // pits[ pit][ lane] is pit value for position in that lane
+    int value[ LeafBatchSize];             // computer store minus human store for each lane
+};
+
 // Function prototype, without which there is no ordering of functions that gets rid
 // of all compiler errors
 char findBestMove( int theBoard[], int whoseTurn, bool displayFlag);
+int validateInput( char userInput);
+
+
+//--------------------------------------------------------------------------------
+// Output layer.  Rather than writing straight to cout, the game emits events (boards,
+// moves, extra moves, captures and messages) which are rendered according to the
+// selected output mode and collected into a buffer.  The buffer is written out once per
+// turn by flushOutput(), and also before reading input when a person is at the keyboard
+// and needs to see the prompt.
+//    HumanOutput  the usual text board and messages
+//    JsonOutput   one JSON object per line for each board, move, extra-move, capture and result
+//    QuietOutput  nothing at all
+enum OutputMode { HumanOutput, JsonOutput, QuietOutput };
+
+struct OutputLayer {
+    OutputMode mode;             // which renderer is in use
+    bool flushBeforeInput;       // true when input is interactive, so prompts must be shown before reading
+    string buffer;               // rendered output waiting to be written
+};
+
+OutputLayer theOutput = { HumanOutput, true, "" };
+
+
+//--------------------------------------------------------------------------------
+// Write out everything that has been rendered so far, then empty the buffer
+void flushOutput()
+{
+    if( theOutput.mode != QuietOutput && !theOutput.buffer.empty()) {
+        cout.write( theOutput.buffer.data(), theOutput.buffer.size());
+        cout.flush();
+    }
+    theOutput.buffer.clear();
+}//end flushOutput()
 
 
 //--------------------------------------------------------------------------------
-// Convert the board integer values into an array of strings.
-// This is necessary only because when the value to be displayed is a 0, then
+// Read a single move character, first showing any pending prompt if input is interactive.
+// If the input runs out, write what is pending and end the program, since no more
+// moves can ever be read.
+void readUserInput( char & userInput)
+{
+    if( theOutput.flushBeforeInput) flushOutput();
+    if( !(cin >> userInput)) {
+        flushOutput();
+        cerr << "Input ended before the game was over." << endl;
+        exit( 1);
+    }
+}//end readUserInput()
+
+
+//--------------------------------------------------------------------------------
+// Return the name used in JSON output for the player whose turn it is
+const char * playerName( int whoseTurn)   // even for human, odd for computer
+{
+    return (whoseTurn % 2 == 0) ? "human" : "computer";
+}//end playerName()
+
+
+//--------------------------------------------------------------------------------
+// Append a single pit value two characters wide.  When the value is a 0
 // we want to display two blanks instead of the numerical value
-void setDisplayValues( int theBoard[ BoardSize],
-                      char displayValues[ BoardSize][3])
+void appendPit( string & text, int value)
+{
+    if( value == 0) {
+        text += "  ";
+    }
+    else {
+        if( value < 10) text += ' ';
+        text += to_string( value);
+    }
+}//end appendPit()
+
+
+//--------------------------------------------------------------------------------
+// Emit a plain text message.  Only the human-readable renderer shows these.
+void emitText( const string & message)
+{
+    if( theOutput.mode == HumanOutput) theOutput.buffer += message;
+}//end emitText()
+
+
+//--------------------------------------------------------------------------------
+// Emit the move chosen by a player.  The human renderer only announces computer moves,
+// since the human has just typed theirs.
+void emitMove( int whoseTurn, char move)
+{
+    if( theOutput.mode == HumanOutput) {
+        if( whoseTurn % 2 == 1) {
+            theOutput.buffer += "   Computer chooses ";
+            theOutput.buffer += move;
+            theOutput.buffer += '\n';
+        }
+    }
+    else if( theOutput.mode == JsonOutput) {
+        theOutput.buffer += "{\"event\":\"move\",\"player\":\"";
+        theOutput.buffer += playerName( whoseTurn);
+        theOutput.buffer += "\",\"move\":\"";
+        theOutput.buffer += move;
+        theOutput.buffer += "\"}\n";
+    }
+}//end emitMove()
+
+
+//--------------------------------------------------------------------------------
+// Emit that the last piece landed in the player's store, so they move again
+void emitExtraMove( int whoseTurn)
+{
+    if( theOutput.mode == HumanOutput) {
+        if( whoseTurn % 2 == 0) {
+            theOutput.buffer += "   You get another move -> ";
+        }
+        else {
+            theOutput.buffer += "   Computer gets another move \n";
+        }
+    }
+    else if( theOutput.mode == JsonOutput) {
+        theOutput.buffer += "{\"event\":\"extra-move\",\"player\":\"";
+        theOutput.buffer += playerName( whoseTurn);
+        theOutput.buffer += "\"}\n";
+    }
+}//end emitExtraMove()
+
+
+//--------------------------------------------------------------------------------
+// Emit a capture of the pieces in the given column ('A'..'F')
+void emitCapture( int whoseTurn, char capturePositionLetter)
+{
+    if( theOutput.mode == HumanOutput) {
+        theOutput.buffer += "   Squares in column ";
+        theOutput.buffer += capturePositionLetter;
+        theOutput.buffer += " are captured.\n";
+    }
+    else if( theOutput.mode == JsonOutput) {
+        theOutput.buffer += "{\"event\":\"capture\",\"player\":\"";
+        theOutput.buffer += playerName( whoseTurn);
+        theOutput.buffer += "\",\"column\":\"";
+        theOutput.buffer += capturePositionLetter;
+        theOutput.buffer += "\"}\n";
+    }
+}//end emitCapture()
+
+
+//--------------------------------------------------------------------------------
+// Emit that the last human move was undone
+void emitUndo()
+{
+    if( theOutput.mode == HumanOutput) {
+        theOutput.buffer += "Previous move undone.\n";
+    }
+    else if( theOutput.mode == JsonOutput) {
+        theOutput.buffer += "{\"event\":\"undo\"}\n";
+    }
+}//end emitUndo()
+
+
+//--------------------------------------------------------------------------------
+// Emit the final store counts and who won
+void emitResult( int theBoard[])
 {
-    for (int i=0; i<BoardSize; i++) {
-        if( theBoard[ i]==0) {
-            strcpy(displayValues[ i], "  ");  // make the entry two blanks
+    const char * winner = "tie";
+    if( theBoard[ 6] > theBoard[13]) winner = "human";
+    else if( theBoard[ 13] > theBoard[6]) winner = "computer";
+    
+    if( theOutput.mode == HumanOutput) {
+        if( theBoard[ 6] > theBoard[13]) theOutput.buffer += "Human wins!\n";
+        else if( theBoard[ 13] > theBoard[6]) theOutput.buffer += "Computer wins!\n";
+        else theOutput.buffer += "Tie Game.\n";
+    }
+    else if( theOutput.mode == JsonOutput) {
+        theOutput.buffer += "{\"event\":\"result\",\"human\":" + to_string( theBoard[ 6]) +
+                            ",\"computer\":" + to_string( theBoard[ 13]) +
+                            ",\"winner\":\"" + winner + "\"}\n";
+    }
+}//end emitResult()
+
+
+//--------------------------------------------------------------------------------
+// Emit the best move found for one position of an analysis corpus.  NoMove is
+// shown as "-" in text and as null in JSON.
+void emitAnalysis( int theBoard[], char bestMove)
+{
+    if( theOutput.mode == HumanOutput) {
+        for( int i=0; i<BoardSize; i++) {
+            theOutput.buffer += to_string( theBoard[ i]);
+            theOutput.buffer += ' ';
+        }
+        theOutput.buffer += "-> ";
+        theOutput.buffer += bestMove;
+        theOutput.buffer += '\n';
+    }
+    else if( theOutput.mode == JsonOutput) {
+        theOutput.buffer += "{\"event\":\"analysis\",\"board\":[";
+        for( int i=0; i<BoardSize; i++) {
+            if( i > 0) theOutput.buffer += ',';
+            theOutput.buffer += to_string( theBoard[ i]);
+        }
+        if( bestMove == NoMove) {
+            theOutput.buffer += "],\"move\":null}\n";
         }
         else {
-            // print the number into the array location, NULL terminating it
-            sprintf(displayValues[ i], "%2d",theBoard[ i],NULL);
+            theOutput.buffer += "],\"move\":\"";
+            theOutput.buffer += bestMove;
+            theOutput.buffer += "\"}\n";
         }
     }
-}//end setDisplayValues()
+}//end emitAnalysis()
 
 
 //--------------------------------------------------------------------------------
@@ -191,23 +397,46 @@ void setDisplayValues( int theBoard[ BoardSize],
 //       -----------------------------
 //         A    B    C    D    E    F
 //
+// In JSON mode the board is emitted as the 14 values in index order.
 void displayBoard( int theBoard[])
 {
-    // Convert the board integer values into array of strings.
-    // This is necessary only because we want to display two blanks, not a 0 when the value is 0
-    char displayValues[ BoardSize][ 3];
-    setDisplayValues( theBoard, displayValues);
-    
-    printf("\n");
-    printf("           A    B    C    D    E    F        \n");
-    printf("          -----------------------------       \n");
-    printf( "    ----| %2s | %2s | %2s | %2s | %2s | %2s |----  \n", displayValues[12], displayValues[11],displayValues[10],
-           displayValues[9],  displayValues[8], displayValues[7]);
-    printf("   | %2s |                             | %2s | \n",      displayValues[13], displayValues[6]);
-    printf( "    ----| %2s | %2s | %2s | %2s | %2s | %2s |----  \n", displayValues[0], displayValues[1], displayValues[2],
-           displayValues[3], displayValues[4], displayValues[5]);
-    printf("         -----------------------------       \n");
-    printf("           A    B    C    D    E    F        \n");
+    string & text = theOutput.buffer;
+    
+    if( theOutput.mode == JsonOutput) {
+        text += "{\"event\":\"board\",\"board\":[";
+        for( int i=0; i<BoardSize; i++) {
+            if( i > 0) text += ',';
+            text += to_string( theBoard[ i]);
+        }
+        text += "]}\n";
+        return;
+    }
+    if( theOutput.mode != HumanOutput) return;
+    
+    text += "\n";
+    text += "           A    B    C    D    E    F        \n";
+    text += "          -----------------------------       \n";
+    text += "    ----|";
+    for( int i=12; i>=7; i--) {
+        text += ' ';
+        appendPit( text, theBoard[ i]);
+        text += " |";
+    }
+    text += "----  \n";
+    text += "   | ";
+    appendPit( text, theBoard[ 13]);
+    text += " |                             | ";
+    appendPit( text, theBoard[ 6]);
+    text += " | \n";
+    text += "    ----|";
+    for( int i=0; i<6; i++) {
+        text += ' ';
+        appendPit( text, theBoard[ i]);
+        text += " |";
+    }
+    text += "----  \n";
+    text += "         -----------------------------       \n";
+    text += "           A    B    C    D    E    F        \n";
 }//end displayBoard()
 
 
@@ -253,6 +482,18 @@ Node * createNode( int theBoard[ BoardSize])
     
 }//end createNode()
 
+
+//--------------------------------------------------------------------------------
+// Delete a node and all of the nodes below it, once the tree is no longer needed
+void deleteNode( Node * pNode)
+{
+    if( pNode == NULL) return;
+    for( int i=0; i<6; i++) {
+        deleteNode( pNode->nextMoves[ i]);
+    }
+    delete pNode;
+}//end deleteNode()
+
 //--------------------------------------------------------------------------------
 // Create a player move, initializing values, returning the address of the player move
 PlayerMove * createPlayerMove( char pmove, int theBoard[BoardSize])
@@ -294,13 +535,14 @@ void insertPlayerMove(PlayerMove * pHead, PlayerMove * humanMove){
 void printPlayerMoves(PlayerMove * pHead){
      PlayerMove * pTemp; 
      pTemp=pHead; //both pTemp and pHead are pointing to the same thing 
-     cout<<"Moves: ";
+     string moves = "Moves: ";
      //Traverse list
      while(pTemp->nextMove !=NULL){
-           cout<<"  "<<pTemp->move; //Print current move
+           moves += "  "; moves += pTemp->move; //Print current move
            pTemp=pTemp->nextMove;
      }
-     cout<<"  "<<pTemp->move<<endl; //Print current move
+     moves += "  "; moves += pTemp->move; moves += '\n'; //Print current move
+     emitText(moves);
 
 }
 
@@ -308,7 +550,7 @@ void printPlayerMoves(PlayerMove * pHead){
 void undoPlayerMove(PlayerMove * pHead, int theBoard[] )
 {
      PlayerMove * pTemp; 
-     PlayerMove * prev;S
+     PlayerMove * prev;
      pTemp=pHead; //both pTemp and pHead are pointing to the same thing 
      
      //Traverse list
@@ -388,7 +630,7 @@ int makeSingleMove( int theBoard[],    // the board
         // storeIndex will still be the default of -1 and we should not do a capture.
         // If the last square is one of the user's store, then do the following.
         if( storeIndex==6 || storeIndex==13) {
-            if( displayIsOn) cout << "   Squares in column " << capturePositionLetter << " are captured." << endl;
+            if( displayIsOn) emitCapture( whoseTurn, capturePositionLetter);
             // Do the capture.  First add user pieces and opposite pieces into the store
             theBoard[ storeIndex] += theBoard[ indexOfLastSquare] + theBoard[ 12-indexOfLastSquare];
             // clear out those spots on the board where the pieces were taken from
@@ -447,8 +689,22 @@ void makeMove( int theBoard[],    // the board
                 // we have to generate an automatic move here.
                 if( displayFlag) {
                     // Human gets another move
-                    cout << "   You get another move -> ";
-                    cin >> userInput;
+                    emitExtraMove( whoseTurn);
+                    readUserInput( userInput);
+                    while( validateInput( userInput) != 1) {
+                        // Same as the main loop: 'x' exits, otherwise show the error and ask again
+                        // until the move is A-F.  Only the prompt is repeated, since this is still
+                        // the same extra move.
+                        if( userInput == 'x' || userInput == 'X') {
+                            emitText( "See ya next time\n");
+                            flushOutput();
+                            exit( 0);
+                        }
+                        emitText( "Incorrect input choosen.\n");
+                        emitText( "   You get another move -> ");
+                        readUserInput( userInput);
+                    }
+                    emitMove( whoseTurn, (char)toupper( userInput));
                 }
                 else {
                     // display is not on, so computer is recursively checking moves, so automatically choose a move for Human
@@ -457,9 +713,9 @@ void makeMove( int theBoard[],    // the board
             }
             else {
                 // Computer gets another move
-                if( displayFlag) cout << "   Computer gets another move \n";
+                if( displayFlag) emitExtraMove( whoseTurn);
                 userInput = findBestMove( theBoard, 1, NoMessages);
-                if( displayFlag) cout << "   Computer chooses " << userInput << " \n";
+                if( displayFlag) emitMove( whoseTurn, userInput);
             }
         }
     }while( userGetsExtraMove(whoseTurn, indexOfLastPieceDropped));
@@ -468,38 +724,82 @@ void makeMove( int theBoard[],    // the board
 
 
 //--------------------------------------------------------------------------------
-// If it is the end of the game, adjust the score recorded for this node, since
-//    all opponent pieces go into the opponent's store.
-void adjustScoreIfEndOfGame( Node * pCurrent)
+// Copy the boards of the child nodes into the lanes of the batch, one lane per child.
+// Unused lanes are cleared so they can be scored along with the others and ignored.
+void loadLeafBatch( LeafBatch & batch,
+                   Node * children[],   // child nodes whose boards are to be scored
+                   int howMany)         // number of children, at most LeafBatchSize
 {
-    // Find out if all human squares are empty and count how many human pieces left if any
-    bool humanSquaresEmpty = true;
-    int remainingHumanPieces = 0;
-    for( int i=0; i<6; i++) {
-        if( pCurrent->theBoard[ i] > 0) {
-            humanSquaresEmpty = false;
-            remainingHumanPieces += pCurrent->theBoard[ i];
+    for( int pit=0; pit<BoardSize; pit++) {
+        for( int lane=0; lane<LeafBatchSize; lane++) {
+            batch.pits[ pit][ lane] = (lane < howMany) ? children[ lane]->theBoard[ pit] : 0;
+        }
+    }
+}//end loadLeafBatch()
+
+
+//--------------------------------------------------------------------------------
+// Score every position in the batch at once.  If it is the end of the game in a position,
+// first adjust its stores, since all of a player's remaining pieces go into that player's
+// store.  The goodness of each position is then the computer store minus the human store.
+// Each step runs across all lanes so sibling positions are evaluated together.
+void evaluateLeafBatch( LeafBatch & batch)
+{
+    int remainingHumanPieces[ LeafBatchSize];
+    int remainingComputerPieces[ LeafBatchSize];
+    
+    // Count pieces left on each side.  Human squares are 0..5; the computer count runs
+    // over 6..12, so it includes the human store and is empty only when that store is too.
+    // Only squares holding more than 0 pieces are counted, so a negative value given on the
+    // command line neither cancels out other pieces nor makes a side look empty.
+    for( int lane=0; lane<LeafBatchSize; lane++) {
+        remainingHumanPieces[ lane] = 0;
+        remainingComputerPieces[ lane] = 0;
+    }
+    for( int pit=0; pit<6; pit++) {
+        for( int lane=0; lane<LeafBatchSize; lane++) {
+            int pieces = batch.pits[ pit][ lane];
+            remainingHumanPieces[ lane] += (pieces > 0) ? pieces : 0;
         }
     }
-    // Same thing, except now for computer squares
-    bool computerSquaresEmpty = true;
-    int remainingComputerPieces = 0;
-    for( int i=6; i<13; i++) {
-        if( pCurrent->theBoard[ i] > 0) {
-            computerSquaresEmpty = false;
-            remainingComputerPieces += pCurrent->theBoard[ i];
+    for( int pit=6; pit<13; pit++) {
+        for( int lane=0; lane<LeafBatchSize; lane++) {
+            int pieces = batch.pits[ pit][ lane];
+            remainingComputerPieces[ lane] += (pieces > 0) ? pieces : 0;
         }
     }
     
-    // Now adjust scores
-    if( humanSquaresEmpty) {
-        pCurrent->theBoard[13] = remainingComputerPieces;
+    // Adjust stores where one side is empty: when the human squares are empty the computer
+    // store becomes the computer count, and when the computer count is empty the human store
+    // becomes the human count.  Then estimate the goodness of each position.
+    for( int lane=0; lane<LeafBatchSize; lane++) {
+        int humanStore = batch.pits[ 6][ lane];
+        int computerStore = batch.pits[ 13][ lane];
+        if( remainingHumanPieces[ lane] == 0) {
+            computerStore = remainingComputerPieces[ lane];
+        }
+        if( remainingComputerPieces[ lane] == 0) {
+            humanStore = remainingHumanPieces[ lane];
+        }
+        batch.pits[ 6][ lane] = humanStore;
+        batch.pits[ 13][ lane] = computerStore;
+        batch.value[ lane] = computerStore - humanStore;
     }
-    if( computerSquaresEmpty) {
-        pCurrent->theBoard[6] = remainingHumanPieces;
+}//end evaluateLeafBatch()
+
+
+//--------------------------------------------------------------------------------
+// Copy the adjusted stores and scores from the batch back into the child nodes
+void storeLeafBatch( LeafBatch & batch,
+                    Node * children[],   // child nodes that were loaded into the batch
+                    int howMany)         // number of children loaded
+{
+    for( int lane=0; lane<howMany; lane++) {
+        children[ lane]->theBoard[ 6] = batch.pits[ 6][ lane];
+        children[ lane]->theBoard[ 13] = batch.pits[ 13][ lane];
+        children[ lane]->bestMoveValue = batch.value[ lane];
     }
-    
-}//end adjustScoreIfEndOfGame()
+}//end storeLeafBatch()
 
 
 //--------------------------------------------------------------------------------
@@ -525,11 +825,18 @@ void expandNode( Node * pRoot,     // existing root node
             // In the line below, the next-to-last parameter (..., 1) indicates it is the computer's move,
             // and the last parameter indicates whether messages should be displayed or not
             makeMove( pCurrentNode->theBoard, (char)('A'+i), whoseTurn, NoMessages);
-            
-            // Adjust store values if one side of board is empty and opponent gets all remaining squares
-            adjustScoreIfEndOfGame( pCurrentNode);
-            // Estimate of the goodness of this node, which is the difference between number of computer and human store pieces
-            pCurrentNode->bestMoveValue = pCurrentNode->theBoard[13] - pCurrentNode->theBoard[6];
+        }//end for( int i...
+        
+        // Score all six children together: adjust store values if one side of a board is empty
+        // and opponent gets all remaining squares, then estimate the goodness of each node, which
+        // is the difference between number of computer and human store pieces
+        LeafBatch batch;
+        loadLeafBatch( batch, pRoot->nextMoves, 6);
+        evaluateLeafBatch( batch);
+        storeLeafBatch( batch, pRoot->nextMoves, 6);
+        
+        for( int i=0; i<6; i++) {
+            Node * pCurrentNode = pRoot->nextMoves[i];
             
             // At odd levels of recursion we choose the maximum score, which is best for the computer
             // At even levels of recursion we choose the minimum score, which is best for the human
@@ -562,9 +869,313 @@ char findBestMove( int theBoard[],
     // the perspective of the human or the computer.
     expandNode( pRoot, whoseTurn);
     
-    return (char) (pRoot->bestMoveIndex + 'A');
+    char bestMove = (char) (pRoot->bestMoveIndex + 'A');
+    deleteNode( pRoot);
+    return bestMove;
 }//end findBestMove()
 
+//--------------------------------------------------------------------------------
+// Sharded analysis.  With "-workers N" the program reads a corpus of positions from
+// standard input, one position per line given as the same 14 values used for the
+// command line board, and finds the computer's best move for each one.  The corpus is
+// split across N forked worker processes by position hash, so each worker builds its
+// search trees in its own heap.  Workers send back "index move" lines over a pipe.
+// A worker that crashes is started again on the same shard, and the results are
+// emitted in corpus order no matter which worker finished first.
+const int MaxWorkerRestarts = 3;    // times a crashed shard is retried before giving up
+const int MaxCorpusPieces = 255;    // most pieces allowed in one square of a corpus position
+
+struct Position {
+    int theBoard[ BoardSize];       // board values in index order
+};
+
+struct Worker {
+    pid_t pid;                      // process id, or -1 when the shard is finished
+    int readFd;                     // read end of the pipe from this worker, or -1 once closed
+    int restarts;                   // number of times this shard has been restarted
+    string received;                // result lines read from the worker so far
+};
+
+
+//--------------------------------------------------------------------------------
+// Hash a position, used to decide which worker it goes to (FNV-1a over the pit values)
+unsigned long hashPosition( int theBoard[])
+{
+    unsigned long hash = 2166136261UL;
+    for( int i=0; i<BoardSize; i++) {
+        hash ^= (unsigned long)theBoard[ i];
+        hash *= 16777619UL;
+        hash &= 0xFFFFFFFFUL;       // keep the same 32-bit value on every platform
+    }
+    return hash;
+}//end hashPosition()
+
+
+//--------------------------------------------------------------------------------
+// Read the corpus, one 14-value position per line.  Blank lines are skipped.
+// Returns false if a line does not hold exactly 14 values, or if any value is
+// outside 0..MaxCorpusPieces.
+bool readCorpus( istream & in, vector< Position> & corpus)
+{
+    string line;
+    int lineNumber = 0;
+    while( getline( in, line)) {
+        lineNumber++;
+        Position position;
+        int count = 0;
+        const char * p = line.c_str();
+        char * end;
+        while( true) {
+            errno = 0;
+            long value = strtol( p, &end, 10);
+            if( end == p) break;
+            if( errno == ERANGE || value < 0 || value > MaxCorpusPieces) {
+                cerr << "Line " << lineNumber << ": board values must be from 0 to " << MaxCorpusPieces << endl;
+                return false;
+            }
+            if( count < BoardSize) position.theBoard[ count] = (int)value;
+            count++;
+            p = end;
+        }
+        while( *p == ' ' || *p == '\t' || *p == '\r') p++;
+        if( count == 0 && *p == '\0') continue;   // blank line
+        if( count != BoardSize || *p != '\0') {
+            cerr << "Line " << lineNumber << ": expected " << BoardSize << " board values" << endl;
+            return false;
+        }
+        corpus.push_back( position);
+    }
+    return true;
+}//end readCorpus()
+
+
+//--------------------------------------------------------------------------------
+// Body of a worker process: analyze every position in this shard, writing the results
+// to the pipe.  Never returns.
+void runWorker( vector< Position> & corpus,
+               int shard,          // which shard this worker handles, 0..numWorkers-1
+               int numWorkers,
+               int writeFd)        // write end of the pipe back to the coordinator
+{
+    string results;
+    for( size_t i=0; i<corpus.size(); i++) {
+        if( (int)(hashPosition( corpus[ i].theBoard) % numWorkers) != shard) continue;
+        // findBestMove() may change its copy of the board while exploring, so give it its own
+        Position position = corpus[ i];
+        char bestMove = findBestMove( position.theBoard, 1, NoMessages);
+        // When no move scores better than the worst possible score there is no best index
+        if( bestMove < 'A' || bestMove > 'F') bestMove = NoMove;
+        results += to_string( i) + " " + bestMove + "\n";
+    }
+    
+    size_t written = 0;
+    while( written < results.size()) {
+        ssize_t n = write( writeFd, results.data() + written, results.size() - written);
+        if( n < 0) {
+            if( errno == EINTR) continue;
+            _exit( 1);
+        }
+        written += n;
+    }
+    close( writeFd);
+    _exit( 0);   // skip exit handlers and stream buffers inherited from the coordinator
+}//end runWorker()
+
+
+//--------------------------------------------------------------------------------
+// Fork a worker process for the given shard.  Returns false if it could not be started.
+bool startWorker( vector< Position> & corpus,
+                 vector< Worker> & workers,
+                 int shard)
+{
+    int fds[ 2];
+    if( pipe( fds) != 0) return false;
+    
+    // Nothing rendered should be pending, or the child would inherit a copy of it
+    flushOutput();
+    cout.flush();
+    
+    pid_t pid = fork();
+    if( pid < 0) {
+        close( fds[ 0]);
+        close( fds[ 1]);
+        return false;
+    }
+    if( pid == 0) {
+        close( fds[ 0]);
+        // Do not hold other workers' pipes open
+        for( size_t i=0; i<workers.size(); i++) {
+            if( workers[ i].readFd >= 0) close( workers[ i].readFd);
+        }
+        runWorker( corpus, shard, (int)workers.size(), fds[ 1]);
+    }
+    
+    close( fds[ 1]);
+    workers[ shard].pid = pid;
+    workers[ shard].readFd = fds[ 0];
+    workers[ shard].received.clear();
+    return true;
+}//end startWorker()
+
+
+//--------------------------------------------------------------------------------
+// Parse the result lines sent back by a worker into the results array.  Returns false
+// if the worker did not report exactly the positions in its shard.
+bool collectResults( vector< Position> & corpus,
+                    const string & received,
+                    int shard,
+                    int numWorkers,
+                    vector< char> & results)
+{
+    vector< char> shardResults( corpus.size(), ' ');
+    const char * p = received.c_str();
+    char * end;
+    while( *p != '\0') {
+        unsigned long index = strtoul( p, &end, 10);
+        if( end == p || *end != ' ' || index >= corpus.size()) return false;
+        char move = end[ 1];
+        if( (move < 'A' || move > 'F') && move != NoMove) return false;
+        if( end[ 2] != '\n') return false;
+        shardResults[ index] = move;
+        p = end + 3;
+    }
+    
+    // Every position in the shard must have an answer, and nothing outside it
+    for( size_t i=0; i<corpus.size(); i++) {
+        bool inShard = (int)(hashPosition( corpus[ i].theBoard) % numWorkers) == shard;
+        if( inShard != (shardResults[ i] != ' ')) return false;
+    }
+    for( size_t i=0; i<corpus.size(); i++) {
+        if( shardResults[ i] != ' ') results[ i] = shardResults[ i];
+    }
+    return true;
+}//end collectResults()
+
+
+//--------------------------------------------------------------------------------
+// Kill and reap every worker that is still running, used when the analysis is abandoned
+void stopWorkers( vector< Worker> & workers)
+{
+    for( size_t i=0; i<workers.size(); i++) {
+        if( workers[ i].readFd >= 0) {
+            close( workers[ i].readFd);
+            workers[ i].readFd = -1;
+        }
+        if( workers[ i].pid != -1) {
+            kill( workers[ i].pid, SIGKILL);
+            while( waitpid( workers[ i].pid, NULL, 0) < 0 && errno == EINTR) {
+            }
+            workers[ i].pid = -1;
+        }
+    }
+}//end stopWorkers()
+
+
+//--------------------------------------------------------------------------------
+// Coordinator for sharded analysis of a corpus read from standard input.
+// Returns the exit status for the program.
+int runAnalysis( int numWorkers)
+{
+    vector< Position> corpus;
+    if( !readCorpus( cin, corpus)) return 1;
+    
+    vector< char> results( corpus.size(), ' ');
+    vector< Worker> workers( numWorkers);
+    for( int shard=0; shard<numWorkers; shard++) {
+        workers[ shard].pid = -1;
+        workers[ shard].readFd = -1;
+        workers[ shard].restarts = 0;
+    }
+    for( int shard=0; shard<numWorkers; shard++) {
+        if( !startWorker( corpus, workers, shard)) {
+            cerr << "Could not start worker " << shard << endl;
+            stopWorkers( workers);
+            return 1;
+        }
+    }
+    
+    int running = numWorkers;
+    vector< pollfd> pollFds;
+    vector< int> pollShards;
+    while( running > 0) {
+        // Wait for output from any worker that still has its pipe open
+        pollFds.clear();
+        pollShards.clear();
+        for( int shard=0; shard<numWorkers; shard++) {
+            if( workers[ shard].readFd < 0) continue;
+            pollfd entry;
+            entry.fd = workers[ shard].readFd;
+            entry.events = POLLIN;
+            entry.revents = 0;
+            pollFds.push_back( entry);
+            pollShards.push_back( shard);
+        }
+        if( poll( &pollFds[ 0], pollFds.size(), -1) < 0) {
+            if( errno == EINTR) continue;
+            cerr << "poll failed" << endl;
+            stopWorkers( workers);
+            return 1;
+        }
+        
+        for( size_t i=0; i<pollFds.size(); i++) {
+            if( pollFds[ i].revents == 0) continue;
+            Worker & worker = workers[ pollShards[ i]];
+            char chunk[ 4096];
+            ssize_t n = read( worker.readFd, chunk, sizeof( chunk));
+            if( n < 0 && errno == EINTR) continue;
+            if( n > 0) {
+                worker.received.append( chunk, n);
+                continue;
+            }
+            
+            // End of file, so the worker is done.  Find out whether it finished cleanly.
+            close( worker.readFd);
+            worker.readFd = -1;
+            int status = 0;
+            while( waitpid( worker.pid, &status, 0) < 0 && errno == EINTR) {
+            }
+            worker.pid = -1;
+            
+            bool exitedCleanly = WIFEXITED( status) && WEXITSTATUS( status) == 0;
+            if( exitedCleanly) {
+                // A worker that finished but sent bad results would do the same again,
+                // so this is not retried
+                bool resultsValid = collectResults( corpus, worker.received, pollShards[ i], numWorkers, results);
+                worker.received.clear();
+                if( !resultsValid) {
+                    cerr << "Worker " << pollShards[ i] << " sent invalid results" << endl;
+                    stopWorkers( workers);
+                    return 1;
+                }
+                running--;
+            }
+            else if( worker.restarts < MaxWorkerRestarts) {
+                // The worker crashed, so re-queue the whole shard on a fresh worker
+                worker.restarts++;
+                cerr << "Worker " << pollShards[ i] << " crashed, restarting" << endl;
+                if( !startWorker( corpus, workers, pollShards[ i])) {
+                    cerr << "Could not restart worker " << pollShards[ i] << endl;
+                    stopWorkers( workers);
+                    return 1;
+                }
+            }
+            else {
+                cerr << "Worker " << pollShards[ i] << " crashed " << MaxWorkerRestarts+1 << " times, giving up" << endl;
+                stopWorkers( workers);
+                return 1;
+            }
+        }
+    }
+    
+    // Merge in corpus order so the output does not depend on which worker finished first
+    for( size_t i=0; i<corpus.size(); i++) {
+        emitAnalysis( corpus[ i].theBoard, results[ i]);
+    }
+    flushOutput();
+    return 0;
+}//end runAnalysis()
+
+
 //function for valdating user input and returning true if user selects A-F and a-f and returning false if user input isnt 
 int validateInput(char userInput){
     if(userInput == 'A' || userInput == 'B' || userInput == 'C' || userInput == 'D' || userInput == 'E'
@@ -576,19 +1187,75 @@ int validateInput(char userInput){
     return 0;
 }
 
+//--------------------------------------------------------------------------------
+// Describe the command line options
+void printUsage()
+{
+    cerr << "Usage: mancala [-json | -quiet] [14 board values]" << endl;
+    cerr << "       mancala [-json | -quiet] -workers N < corpus" << endl;
+    cerr << "   -workers N  analyze positions read from standard input, one per line as 14 board" << endl;
+    cerr << "               values, using N worker processes (N from 1 to 1024)" << endl;
+}//end printUsage()
+
+
 //--------------------------------------------------------------------------------
 int main(int argc, char * argv[])
 {
     //    index :    0 1 2 3 4 5 6 7 8 9 10 11 12 13
     int theBoard[ ]={3,3,3,3,3,3,0,3,3,3, 3, 3, 3, 0};
     
-    if(argc == 15){ //User provided command prompts for board initilization
+    // Pick the output renderer from the command line.  "-json" writes one JSON object per
+    // line for each event and "-quiet" writes nothing; the default is the text board.
+    // "-workers N" analyzes a corpus of positions from standard input instead of playing.
+    // Any other arguments are the board values.
+    int numWorkers = 0;      // 0 means play a game rather than analyze a corpus
+    char * boardArgs[ BoardSize+1];
+    int boardArgCount = 0;
+    for( int i=1; i<argc; i++) {
+        if( strcmp( argv[ i], "-json") == 0) {
+            theOutput.mode = JsonOutput;
+        }
+        else if( strcmp( argv[ i], "-quiet") == 0) {
+            theOutput.mode = QuietOutput;
+        }
+        else if( strcmp( argv[ i], "-workers") == 0) {
+            // The count must be given and be a whole number of at least 1
+            char * end = NULL;
+            long count = (i+1 < argc) ? strtol( argv[ i+1], &end, 10) : 0;
+            if( i+1 >= argc || end == argv[ i+1] || *end != '\0' || count < 1 || count > 1024) {
+                printUsage();
+                return 1;
+            }
+            numWorkers = (int)count;
+            i++;
+        }
+        else if( boardArgCount <= BoardSize) {
+            boardArgs[ boardArgCount++] = argv[ i];
+        }
+    }
+    
+    if(boardArgCount == BoardSize){ //User provided command prompts for board initilization
        // place copy of current board into node
        for( int i=0; i<BoardSize; i++) {
-          theBoard[ i] =atoi(argv[i+1]);
+          theBoard[ i] =atoi(boardArgs[i]);
        }
     }
     
+    // Output is written once per turn.  Only when someone is typing at the keyboard does
+    // it also need to be written before each read, so that the prompt is visible.
+    theOutput.flushBeforeInput = isatty( fileno( stdin));
+    ios::sync_with_stdio( false);
+    cin.tie( NULL);
+    
+    if( numWorkers > 0) {
+        // The corpus comes from standard input, so a board on the command line has no meaning
+        if( boardArgCount > 0) {
+            printUsage();
+            return 1;
+        }
+        return runAnalysis( numWorkers);
+    }
+    
 
     int moveNumber = 1;      // counts moves that are made by the user
     char userInput = ' ';    // stores user input of moves to make
@@ -600,15 +1267,15 @@ int main(int argc, char * argv[])
     srand( 1);   // make it predictable for now
     
     // display identifying information
-    cout << "Author: Dale Reed " << endl;
-    cout << "Program 5: Mancala" << endl;
-    cout << "TA: Susan Rice, Wed 7am" << endl;
-    cout << "Nov 27, 2012" << endl;
-    cout << endl;
+    emitText( "Author: Dale Reed \n");
+    emitText( "Program 5: Mancala\n");
+    emitText( "TA: Susan Rice, Wed 7am\n");
+    emitText( "Nov 27, 2012\n");
+    emitText( "\n");
     
-    cout << "Welcome to the game of Mancala, where you are playing against " << endl;
-    cout << "a computer opponent.  Your holes are on the bottom row and " << endl;
-    cout << "you get to go first. " << endl;
+    emitText( "Welcome to the game of Mancala, where you are playing against \n");
+    emitText( "a computer opponent.  Your holes are on the bottom row and \n");
+    emitText( "you get to go first. \n");
     
     // main loop, alternating between human and computer.
     // Loop counter keeps incrementing. When it is even (0,2,4,...) it is the Human's turn
@@ -618,11 +1285,11 @@ int main(int argc, char * argv[])
     int userCounter = 0;
     while( movesRemaining( theBoard)) {
         displayBoard( theBoard);
-        cout << "-------------------------------------------\n" << endl;
+        emitText( "-------------------------------------------\n\n");
         
         // Prompt for human move and make the move
-        cout << moveNumber << ". Select a move (A..F)-> ";
-        cin >> userInput;
+        emitText( to_string( moveNumber) + ". Select a move (A..F)-> ");
+        readUserInput( userInput);
         //checking user input for correct validation for undo move
         while(userInput == 'u' || userInput == 'U' )
         {
@@ -630,23 +1297,25 @@ int main(int argc, char * argv[])
             undoPlayerMove(pHead, theBoard);
             
             // Prompt for human move and make the move
-            cout<< "Previous move undone."<<endl;
+            emitUndo();
             displayBoard( theBoard);
-            cout << moveNumber << ". Select a move (A..F)-> ";
-            cin >> userInput;
+            emitText( to_string( moveNumber) + ". Select a move (A..F)-> ");
+            readUserInput( userInput);
           
         }
         if (userInput == 'x' || userInput == 'X' ) //and exiting the program
         {
-             cout<< "See ya next time"<<endl;
+             emitText( "See ya next time\n");
+             flushOutput();
              exit(0);
          }
         while(validateInput(userInput) != 1){         //this while loop us for when userput isnt true meaning that
                                                       //A-F and a-f the loop will continue to run if the the input isnt valid and display 
-             cout<<"Incorrect input choosen."<<endl;    //the error message and ask user for the correct input again
-             cout << moveNumber << ". Select a move (A..F)-> "<<endl;
-             cin >> userInput;
+             emitText( "Incorrect input choosen.\n");    //the error message and ask user for the correct input again
+             emitText( to_string( moveNumber) + ". Select a move (A..F)-> \n");
+             readUserInput( userInput);
         }               
+        emitMove( userCounter, (char)toupper( userInput));
         makeMove( theBoard, userInput, userCounter++, DisplayMessages);  // make a move from the userInput position for the player to move
         //create PlayerMove
         PlayerMove * pmove = createPlayerMove(userInput, theBoard);
@@ -657,19 +1326,22 @@ int main(int argc, char * argv[])
         moveNumber++;  // update moveNumber
         
         displayBoard( theBoard);
-        cout << "   ----------------------------------------\n" << endl;
+        emitText( "   ----------------------------------------\n\n");
         
         // Find the computer move and make that move
         computerMove = findBestMove( theBoard, 1, NoMessages);
-        cout << "   Computer chooses " << computerMove << endl;
+        emitMove( userCounter, computerMove);
         makeMove( theBoard, computerMove, userCounter++, DisplayMessages);  // make a move from the userInput position for the player to move
+        
+        // End of the turn, so write out everything from both moves at once
+        flushOutput();
 
         
     }//end while( movesRemaining(...)
     
     displayBoard( theBoard);
     
-    cout << "Game is over.  Remaining pieces are being placed into the store." << endl;
+    emitText( "Game is over.  Remaining pieces are being placed into the store.\n");
     // Place all remaining pieces in the appropriate store and blank out where those pieces came from
     for (int i=0; i<13; i++) {
         if( i<6) {
@@ -684,17 +1356,10 @@ int main(int argc, char * argv[])
     displayBoard( theBoard);
     
     // Display who won
-    if( theBoard[ 6] > theBoard[13]) {
-        cout << "Human wins!" << endl;
-    }
-    else if( theBoard[ 13] > theBoard[6]) {
-        cout << "Computer wins!" << endl;
-    }
-    else {
-        cout << "Tie Game." << endl;
-    }
+    emitResult( theBoard);
     
-    cout << "Thanks for playing!  Goodbye..." << endl;
+    emitText( "Thanks for playing!  Goodbye...\n");
+    flushOutput();
     return 0;
 }// end main()
 